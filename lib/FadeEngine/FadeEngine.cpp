@@ -0,0 +1,193 @@
+#include "FadeEngine.h"
+
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "driver/ledc.h"
+#include "driver/gpio.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define TAG "fade_engine"
+
+#define FADE_SPEED_MODE   LEDC_LOW_SPEED_MODE
+#define FADE_TIMER        LEDC_TIMER_0
+#define FADE_RESOLUTION   LEDC_TIMER_13_BIT
+#define FADE_FREQUENCY_HZ 5000
+
+static_assert(FADE_RESOLUTION == FADE_DUTY_BITS, "gamma table and LEDC timer must use the same duty resolution");
+
+// Callers only record the latest wanted level per channel and wake TaskFades.
+// The task hands each segment to the LEDC hardware and sleeps until the
+// fade-end interrupt, a new request or the end of a segment held at a constant
+// duty. The scheduling decisions themselves live in FadeSchedule.h.
+
+static fade_slot_t s_fade[LEDC_CHANNEL_MAX];
+static int s_channel_count = 0;
+static portMUX_TYPE s_fade_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_fade_task = NULL;
+static fade_level_cb_t s_on_level = NULL;
+
+static bool IRAM_ATTR fade_end_cb(const ledc_cb_param_t *param, void *user_arg)
+{
+    BaseType_t woken = pdFALSE;
+
+    if (param->event == LEDC_FADE_END_EVT) {
+        portENTER_CRITICAL_ISR(&s_fade_lock);
+        fade_slot_end(&s_fade[param->channel]);
+        portEXIT_CRITICAL_ISR(&s_fade_lock);
+        vTaskNotifyGiveFromISR(s_fade_task, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+static esp_err_t fade_start(ledc_channel_t ch, uint32_t target_duty, uint32_t ms)
+{
+    esp_err_t ret = ledc_set_fade_with_time(FADE_SPEED_MODE, ch, target_duty, ms);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return ledc_fade_start(FADE_SPEED_MODE, ch, LEDC_FADE_NO_WAIT);
+}
+
+static uint32_t fade_now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void fade_task(void *parameter)
+{
+    TickType_t wait = portMAX_DELAY;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        uint32_t now = fade_now_ms();
+        uint32_t wait_ms = FADE_WAIT_FOREVER;
+
+        for (int ch = 0; ch < s_channel_count; ch++) {
+            ledc_channel_t channel = (ledc_channel_t)ch;
+            uint32_t current_duty = ledc_get_duty(FADE_SPEED_MODE, channel);
+            fade_step_t step;
+
+            portENTER_CRITICAL(&s_fade_lock);
+            bool start = fade_slot_next(&s_fade[ch], current_duty, now, &step);
+            portEXIT_CRITICAL(&s_fade_lock);
+
+            if (start) {
+                // A segment that keeps the duty unchanged is just a timed hold
+                bool hardware = step.ms > 0 && step.duty != current_duty;
+                esp_err_t ret = hardware
+                    ? fade_start(channel, step.duty, step.ms)
+                    : ledc_set_duty_and_update(FADE_SPEED_MODE, channel, step.duty, 0);
+
+                portENTER_CRITICAL(&s_fade_lock);
+                fade_slot_started(&s_fade[ch], ret == ESP_OK, hardware);
+                portEXIT_CRITICAL(&s_fade_lock);
+
+                if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed to start fade on LEDC channel %d: %s", ch, esp_err_to_name(ret));
+                }
+                if (s_on_level != NULL && (step.first || ret != ESP_OK)) {
+                    s_on_level(ch, ret == ESP_OK ? step.level : fade_duty_to_level(ledc_get_duty(FADE_SPEED_MODE, channel)));
+                }
+            }
+
+            portENTER_CRITICAL(&s_fade_lock);
+            uint32_t slot_wait = fade_slot_wait_ms(&s_fade[ch], now);
+            portEXIT_CRITICAL(&s_fade_lock);
+            if (slot_wait < wait_ms) {
+                wait_ms = slot_wait;
+            }
+        }
+
+        wait = wait_ms == FADE_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms);
+    }
+}
+
+// ========= Public API =========
+
+esp_err_t fade_init(fade_level_cb_t on_level)
+{
+    s_on_level = on_level;
+
+    ledc_timer_config_t timer_config = {};
+    timer_config.speed_mode = FADE_SPEED_MODE;
+    timer_config.duty_resolution = FADE_RESOLUTION;
+    timer_config.timer_num = FADE_TIMER;
+    timer_config.freq_hz = FADE_FREQUENCY_HZ;
+    timer_config.clk_cfg = LEDC_AUTO_CLK;
+
+    esp_err_t ret = ledc_timer_config(&timer_config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure LEDC timer");
+        return ret;
+    }
+
+    ret = ledc_fade_func_install(0);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to install LEDC fade service");
+        return ret;
+    }
+
+    if (xTaskCreatePinnedToCore(fade_task, "TaskFades", 4096, NULL, 1, &s_fade_task, 1) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create fade task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+int fade_attach(int pin)
+{
+    if (s_fade_task == NULL) {
+        ESP_LOGE(TAG, "Fade engine not initialized, cannot attach pin %d", pin);
+        return -1;
+    }
+    if (s_channel_count >= LEDC_CHANNEL_MAX) {
+        ESP_LOGE(TAG, "No LEDC channel left for pin %d", pin);
+        return -1;
+    }
+    int ch = s_channel_count;
+
+    ledc_channel_config_t channel_config = {};
+    channel_config.gpio_num = pin;
+    channel_config.speed_mode = FADE_SPEED_MODE;
+    channel_config.channel = (ledc_channel_t)ch;
+    channel_config.intr_type = LEDC_INTR_DISABLE;
+    channel_config.timer_sel = FADE_TIMER;
+    channel_config.duty = 0;
+    channel_config.hpoint = 0;
+
+    if (ledc_channel_config(&channel_config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure LEDC channel %d on pin %d", ch, pin);
+        return -1;
+    }
+
+    ledc_cbs_t callbacks = {};
+    callbacks.fade_cb = fade_end_cb;
+    if (ledc_cb_register(FADE_SPEED_MODE, (ledc_channel_t)ch, &callbacks, NULL) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register fade callback for LEDC channel %d", ch);
+        // Release the pin so the caller can drive it as a plain output
+        ledc_stop(FADE_SPEED_MODE, (ledc_channel_t)ch, 0);
+        gpio_reset_pin((gpio_num_t)pin);
+        return -1;
+    }
+
+    s_channel_count++;
+    return ch;
+}
+
+esp_err_t fade_to(int ledc_channel, uint8_t level, uint32_t ms)
+{
+    if (ledc_channel < 0 || ledc_channel >= s_channel_count || s_fade_task == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_fade_lock);
+    fade_slot_request(&s_fade[ledc_channel], level, ms);
+    portEXIT_CRITICAL(&s_fade_lock);
+
+    xTaskNotifyGive(s_fade_task);
+    return ESP_OK;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#ifndef FADEENGINE_H_
+#define FADEENGINE_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "FadeSchedule.h"
+
+// Called from TaskFades with the level a channel is heading to once the
+// hardware has taken a request, or with the level it is left at if it failed.
+typedef void (*fade_level_cb_t)(int ledc_channel, uint8_t level);
+
+// Installs the LEDC fade service and starts the task that schedules fades.
+esp_err_t fade_init(fade_level_cb_t on_level);
+
+// Binds an output pin to the next free LEDC channel, starting at duty 0.
+// Returns the LEDC channel number or -1 if none is left.
+int fade_attach(int pin);
+
+// Requests a hardware fade of an attached LEDC channel to `level` over `ms`
+// milliseconds (0 = jump immediately). Never blocks: the request is handed to
+// the fade task and replaces any request still pending for that channel. A
+// running fade gives way within FADE_SEGMENT_MS on every IDF version.
+esp_err_t fade_to(int ledc_channel, uint8_t level, uint32_t ms);
+
+#endif
@@ -0,0 +1,166 @@
+#pragma once
+#ifndef FADESCHEDULE_H_
+#define FADESCHEDULE_H_
+
+// Gamma table and per-channel fade scheduling used by FadeEngine. Kept free of
+// ESP-IDF/FreeRTOS headers so it also builds in the native test environment.
+
+#include <stdint.h>
+
+#define FADE_LEVEL_MAX    100       // brightness levels are expressed in percent (0..100)
+#define FADE_MAX_MS       60000     // longest fade accepted by fade_to()
+#define FADE_SEGMENT_MS   250       // longest single hardware fade, bounds how long a new request waits
+#define FADE_DUTY_BITS    13
+#define FADE_DUTY_MAX     ((1 << FADE_DUTY_BITS) - 1)
+#define FADE_WAIT_FOREVER UINT32_MAX
+
+// ========= Gamma table =========
+// Perceived brightness is not linear in duty, so levels go through the CIE 1931
+// lightness curve. The table is expanded by the compiler; nothing runs at boot.
+
+constexpr double fade_cube(double x) { return x * x * x; }
+
+constexpr uint16_t fade_cie_duty(unsigned level)
+{
+    return level <= 8
+        ? (uint16_t)(FADE_DUTY_MAX * (level / 903.3) + 0.5)
+        : (uint16_t)(FADE_DUTY_MAX * fade_cube((level + 16) / 116.0) + 0.5);
+}
+
+template<unsigned... Is> struct fade_index_list {};
+template<unsigned N, unsigned... Is> struct fade_make_indices : fade_make_indices<N - 1, N - 1, Is...> {};
+template<unsigned... Is> struct fade_make_indices<0, Is...> { typedef fade_index_list<Is...> type; };
+
+template<typename Indices> struct fade_gamma_table;
+template<unsigned... Is> struct fade_gamma_table<fade_index_list<Is...>> {
+    static constexpr uint16_t duty[sizeof...(Is)] = { fade_cie_duty(Is)... };
+};
+template<unsigned... Is> constexpr uint16_t fade_gamma_table<fade_index_list<Is...>>::duty[sizeof...(Is)];
+
+typedef fade_gamma_table<fade_make_indices<FADE_LEVEL_MAX + 1>::type> fade_gamma;
+
+static_assert(fade_gamma::duty[0] == 0, "level 0 must switch the output fully off");
+static_assert(fade_gamma::duty[FADE_LEVEL_MAX] == FADE_DUTY_MAX, "level 100 must drive the output fully on");
+
+// Gamma-corrected duty for a brightness level, levels above FADE_LEVEL_MAX are clamped.
+inline uint32_t fade_level_to_duty(uint8_t level)
+{
+    return fade_gamma::duty[level > FADE_LEVEL_MAX ? FADE_LEVEL_MAX : level];
+}
+
+// Highest level whose duty does not exceed `duty`.
+inline uint8_t fade_duty_to_level(uint32_t duty)
+{
+    uint8_t level = 0;
+    while (level < FADE_LEVEL_MAX && fade_gamma::duty[level + 1] <= duty) {
+        level++;
+    }
+    return level;
+}
+
+// ========= Scheduling =========
+// A fade is played as a chain of hardware fades of at most FADE_SEGMENT_MS, so
+// a new request replaces the running one at the next segment boundary without
+// needing ledc_fade_stop() (only available from ESP-IDF 5.0). The level moves
+// linearly in time and each segment ends on the gamma table, so the hardware
+// only interpolates linearly in duty across one short piece of the curve.
+// Only the latest request per channel is kept. Callers serialize access to a slot.
+
+typedef struct {
+    uint8_t level;        // pending request
+    uint32_t ms;
+    bool pending;
+    bool busy;            // hardware segment running, until fade_slot_end()
+    uint8_t from_level;   // active fade, linear in level from from_level to target_level
+    uint8_t target_level;
+    uint32_t total_ms;
+    uint32_t elapsed_ms;
+    uint32_t segment_end_ms;
+} fade_slot_t;
+
+typedef struct {
+    uint32_t duty;   // duty to reach at the end of this segment
+    uint32_t ms;     // segment length, 0 = set duty immediately
+    uint8_t level;   // level the whole fade is heading to
+    bool first;      // first segment of a new request
+} fade_step_t;
+
+// Records a request, replacing any that has not started yet.
+inline void fade_slot_request(fade_slot_t *slot, uint8_t level, uint32_t ms)
+{
+    slot->level = level > FADE_LEVEL_MAX ? FADE_LEVEL_MAX : level;
+    slot->ms = ms > FADE_MAX_MS ? FADE_MAX_MS : ms;
+    slot->pending = true;
+}
+
+// Produces the next segment to program, or false when the channel is busy, is
+// holding until `segment_end_ms` or has nothing left to do. Marks the slot busy.
+inline bool fade_slot_next(fade_slot_t *slot, uint32_t current_duty, uint32_t now_ms, fade_step_t *step)
+{
+    if (slot->busy) {
+        return false;
+    }
+
+    step->first = slot->pending;
+    if (slot->pending) {
+        slot->pending = false;
+        slot->from_level = fade_duty_to_level(current_duty);
+        slot->target_level = slot->level;
+        slot->total_ms = slot->ms;
+        slot->elapsed_ms = 0;
+    } else if (slot->elapsed_ms >= slot->total_ms || (int32_t)(now_ms - slot->segment_end_ms) < 0) {
+        return false;
+    }
+
+    uint32_t remaining = slot->total_ms - slot->elapsed_ms;
+    step->ms = remaining < FADE_SEGMENT_MS ? remaining : FADE_SEGMENT_MS;
+    slot->elapsed_ms += step->ms;
+    int32_t level = slot->total_ms == 0
+        ? slot->target_level
+        : slot->from_level
+            + (int32_t)(((int64_t)slot->target_level - slot->from_level) * slot->elapsed_ms / slot->total_ms);
+    step->duty = fade_level_to_duty((uint8_t)level);
+    step->level = slot->target_level;
+
+    slot->segment_end_ms = now_ms + step->ms;
+    slot->busy = true;
+    return true;
+}
+
+// Reports how a segment was applied. Segments set without a hardware fade
+// (immediate or unchanged duty) raise no fade-end interrupt, and a failed
+// start abandons the rest of the fade.
+inline void fade_slot_started(fade_slot_t *slot, bool ok, bool hardware)
+{
+    if (!ok) {
+        slot->elapsed_ms = slot->total_ms;
+    }
+    if (!ok || !hardware) {
+        slot->busy = false;
+    }
+}
+
+// Called when the hardware fade of a segment ends.
+inline void fade_slot_end(fade_slot_t *slot)
+{
+    slot->busy = false;
+}
+
+// How long the scheduler may sleep before this slot needs fade_slot_next() again.
+// Busy slots are woken by fade_slot_end() instead.
+inline uint32_t fade_slot_wait_ms(const fade_slot_t *slot, uint32_t now_ms)
+{
+    if (slot->busy) {
+        return FADE_WAIT_FOREVER;
+    }
+    if (slot->pending) {
+        return 0;
+    }
+    if (slot->elapsed_ms >= slot->total_ms) {
+        return FADE_WAIT_FOREVER;
+    }
+    int32_t left = (int32_t)(slot->segment_end_ms - now_ms);
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+#endif
@@ -11,6 +11,7 @@
 #include <ESPmDNS.h>
 #include <ArduinoOTA.h>
 #include <credentials.h>
+#include <FadeEngine.h>
 
 // WiFi and MQTT
 const char *ssid              = WIFI_SSID;
@@ -22,16 +23,25 @@ const bool  hide_SSID         = false; // To disable SSID broadcast -> SSID will
 const int   max_connection    = 3;
 
 #define DEBOUNCE_DELAY 50 // ms
+#define FADE_DEFAULT_MS 400 // fade used by buttons/toggles on PWM outputs
+
+enum OutputType {
+  RELAY,  // on/off through digitalWrite
+  PWM     // dimmable, faded by the LEDC hardware (see FadeEngine)
+};
 
 struct MapDevice{
   int channel;
   std::vector<int> inputPins;
   std::vector<int> outputPins;
+  OutputType outputType;
   std::vector<bool> inputState;
   std::vector<unsigned long> lastDebounceTime;
   std::vector<bool> lastButtonState;
   std::vector<bool> outputState;
+  uint8_t level;                 // 0..FADE_LEVEL_MAX, RELAY outputs are either 0 or FADE_LEVEL_MAX
   std::string name;
+  int ledcChannel;               // assigned by setupPins() for PWM outputs, -1 otherwise
 };
 
 // Initialize with pin numbers; state vectors must match size
@@ -40,41 +50,53 @@ std::vector<MapDevice> devices = {
     0,                   // device channel
     {32},                // input pin(s): 1 or more buttons/sensor/switch to control the output
     {23},                // output pin(s): 1 or more output can be controlled by the input
+    RELAY,               // output type: RELAY or PWM (PWM dims the first output pin only)
     {false},             // initial input state(s): state of each input pin
     {0},                 // last debounce time of each input
     {HIGH},              // last input state of each input (with INPUT_PULLUP, not pressed = HIGH)
     {false},             // output state of each output (false = OFF)
-    "Luz_Cozinha"        // device's name
+    0,                   // brightness level (0..100)
+    "Luz_Cozinha",       // device's name
+    -1                   // LEDC channel, filled in by setupPins()
   },
   {
     1,
     {33},
     {22},
+    RELAY,
     {false},
     {0},
     {HIGH},
     {false},
-    "Luz_Lavanderia"
+    0,
+    "Luz_Lavanderia",
+    -1
   },
   {
     2,
     {25},                // one switch for same light
     {21},                // one light
+    RELAY,
     {false},
     {0},
     {HIGH},
     {false},
-    "Luz_Corredor_Quintal"
+    0,
+    "Luz_Corredor_Quintal",
+    -1
   },
   {
     3,
     {26, 27},            // two switches for same light
     {19},                // one light
+    RELAY,
     {false, false},
     {0, 0},
     {HIGH, HIGH},
     {false},
-    "Luz_Quarto_Fabio"
+    0,
+    "Luz_Quarto_Fabio",
+    -1
   }
 };
 
@@ -96,24 +118,44 @@ void checkButtons();
 void setupPins();
 // void setupRestAPI();
 
-void toggleDevice(MapDevice& device, bool newState) {
-    device.outputState[0] = newState;
-    digitalWrite(device.outputPins[0], newState ? HIGH : LOW);
+void publishDeviceState(MapDevice& device) {
+    char topicState[32];
+    sprintf(topicState, "channel%d:%s:%d", device.channel, device.outputState[0] ? "ON" : "OFF", device.level); // TBD: may change to device.name instead of ch(channel)
+    events.send(topicState, "update", millis());
+}
 
-    char topicState[64], topicControl[64];
-    char payload[8];
-    int channel = device.channel;
-    String status = newState ? "ON" : "OFF";
+bool setDeviceLevel(MapDevice& device, uint8_t level, uint32_t ms) {
+    if (device.outputType == PWM) {
+      // Returns right away; state is published by onFadeLevel() once the LEDC hardware takes the request
+      return fade_to(device.ledcChannel, level, ms) == ESP_OK;
+    }
+    level = level > 0 ? FADE_LEVEL_MAX : 0;
+    digitalWrite(device.outputPins[0], level > 0 ? HIGH : LOW);
+    device.level = level;
+    device.outputState[0] = level > 0;
+    publishDeviceState(device);
+    return true;
+}
 
-    sprintf(payload, status.c_str());
+// Runs in TaskFades
+void onFadeLevel(int ledcChannel, uint8_t level) {
+  for (auto& device : devices) {
+    if (device.outputType == PWM && device.ledcChannel == ledcChannel) {
+      device.level = level;
+      device.outputState[0] = level > 0;
+      publishDeviceState(device);
+      return;
+    }
+  }
+}
 
-    sprintf(topicState, "channel%d:%s", device.channel, status); // TBD: may change to device.name instead of ch(channel)
-    events.send(topicState, "update", millis());
+bool toggleDevice(MapDevice& device, bool newState) {
+  return setDeviceLevel(device, newState ? FADE_LEVEL_MAX : 0, FADE_DEFAULT_MS);
 }
 
-void toggleDevice(MapDevice& device) {
+bool toggleDevice(MapDevice& device) {
   bool newState = !device.outputState[0];
-  toggleDevice(device, newState);
+  return toggleDevice(device, newState);
 }
 
 void TaskButtons(void *parameter)
@@ -202,6 +244,17 @@ void setup()
 {
   Serial.begin(115200);
 
+  // The fade engine (LEDC timer, fade ISR and TaskFades) is only needed for dimmable outputs
+  bool hasPwmOutput = false;
+  for (auto& device : devices) {
+    if (device.outputType == PWM) {
+      hasPwmOutput = true;
+    }
+  }
+  if (hasPwmOutput && fade_init(onFadeLevel) != ESP_OK) {
+    Serial.println("[!] Failed to start LEDC fade engine, PWM outputs disabled");
+  }
+
   setupPins();
 
   setupWifi();
@@ -300,6 +353,19 @@ void setupWifi() {
 //   return payload;
 // }
 
+// String::toInt() returns 0 for anything it cannot parse, so check first
+bool isNumber(const String& value) {
+  if (value.length() == 0) {
+    return false;
+  }
+  for (size_t i = 0; i < value.length(); i++) {
+    if (!isDigit(value[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void asyncWebServerRoutes() {
   // Async Web Server Routes
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
@@ -312,10 +378,14 @@ void asyncWebServerRoutes() {
 
       if(ch >= 0 && ch < devices.size()) {
         MapDevice& mapDevice = findDeviceByChannel(ch);
+        bool newState = !mapDevice.outputState[0];
 
-        toggleDevice(mapDevice);
+        if (!toggleDevice(mapDevice, newState)) {
+          request->send(500, "text/plain", "Failed to change the device state");
+          return;
+        }
 
-        String msg = "The device channel: " + String(mapDevice.channel) + " has been changed its state to: " + (mapDevice.outputState[0] ? "ON" : "OFF");
+        String msg = "The device channel: " + String(mapDevice.channel) + " has been changed its state to: " + (newState ? "ON" : "OFF");
 
         request->send(200, "text/plain", msg);
       } else {
@@ -329,8 +399,8 @@ void asyncWebServerRoutes() {
   events.onConnect([](AsyncEventSourceClient *client) {
     for (auto& device : devices) {
       for (size_t j = 0; j < device.outputState.size(); j++) {
-        char msg[20];
-        sprintf(msg, "channel%d:%s", device.channel, device.outputState[j] ? "ON" : "OFF");
+        char msg[32];
+        sprintf(msg, "channel%d:%s:%d", device.channel, device.outputState[j] ? "ON" : "OFF", device.level);
         client->send(msg, "update", millis());
       }
     }
@@ -339,7 +409,7 @@ void asyncWebServerRoutes() {
  server.on("/api/devices", HTTP_GET, [](AsyncWebServerRequest *request) {
     String json = "[";
     for(int i=0; i<devices.size(); i++){
-      json += "{\"channel\":" + String(devices[i].channel) + ",\"name\":\"" + devices[i].name.c_str() + "\",\"outputState\":" + (devices[i].outputState[0] ? "true" : "false") + "}";
+      json += "{\"channel\":" + String(devices[i].channel) + ",\"name\":\"" + devices[i].name.c_str() + "\",\"outputType\":\"" + (devices[i].outputType == PWM ? "PWM" : "RELAY") + "\",\"outputState\":" + (devices[i].outputState[0] ? "true" : "false") + ",\"level\":" + String(devices[i].level) + "}";
       
       if(i < devices.size() - 1) {
         json += ",";
@@ -362,7 +432,10 @@ void asyncWebServerRoutes() {
 
       for(int i=0; i<devices.size(); i++){
         if(devices[i].channel == channel) {
-          toggleDevice(devices[i], state);
+          if (!toggleDevice(devices[i], state)) {
+            request->send(500, "text/plain", "Failed to change the device state");
+            return;
+          }
           String msg = String(devices[i].name.c_str()) + " on channel: " + String(devices[i].channel) + " has change state to: " + String(state ? "ON" : "OFF");
           request->send(200, "text/plain", msg);
           return;
@@ -375,6 +448,49 @@ void asyncWebServerRoutes() {
     }
   });
 
+  server.on("/api/device/level", HTTP_POST, [](AsyncWebServerRequest *request) {
+    if (request->hasParam("channel") && request->hasParam("level")) {
+      const String& channelParam = request->getParam("channel")->value();
+      const String& levelParam = request->getParam("level")->value();
+      String msParam = request->hasParam("ms") ? request->getParam("ms")->value() : String(FADE_DEFAULT_MS);
+
+      if (!isNumber(channelParam) || !isNumber(levelParam) || !isNumber(msParam)) {
+        request->send(400, "text/plain", "Bad Request");
+        return;
+      }
+
+      int channel = channelParam.toInt();
+      long level = levelParam.toInt();
+      long ms = msParam.toInt();
+
+      if (level < 0 || level > FADE_LEVEL_MAX || ms < 0 || ms > FADE_MAX_MS) {
+        request->send(400, "text/plain", "Bad Request");
+        return;
+      }
+
+      for(int i=0; i<devices.size(); i++){
+        if(devices[i].channel == channel) {
+          if (!setDeviceLevel(devices[i], level, ms)) {
+            request->send(500, "text/plain", "Failed to change the device level");
+            return;
+          }
+          String msg = String(devices[i].name.c_str()) + " on channel: " + String(devices[i].channel);
+          if (devices[i].outputType == PWM) {
+            msg += String(" is fading to level: ") + String(level) + " in " + String(ms) + "ms";
+          } else {
+            msg += String(" has change state to: ") + String(devices[i].outputState[0] ? "ON" : "OFF"); // relays switch at once, ms is ignored
+          }
+          request->send(200, "text/plain", msg);
+          return;
+        }
+      }
+
+      request->send(404, "text/plain", "Device not found");
+    } else {
+      request->send(400, "text/plain", "Bad Request");
+    }
+  });
+
   Serial.println("Rest API is Ready");
 
   server.addHandler(&events);
@@ -414,11 +530,22 @@ void setupPins() {
     for (int in : device.inputPins) {
       pinMode(in, INPUT_PULLUP);
     }
+    if (device.outputType == PWM) {
+      device.ledcChannel = fade_attach(device.outputPins[0]);
+      if (device.ledcChannel < 0) {
+        Serial.printf("[!] No PWM for %s, falling back to relay output\n", device.name.c_str());
+        device.outputType = RELAY;
+      }
+    }
     for (size_t i = 0; i < device.outputPins.size(); i++) {
+      device.outputState[i] = false;
+      if (device.outputType == PWM && i == 0) {
+        continue; // driven by LEDC, starts at duty 0
+      }
       pinMode(device.outputPins[i], OUTPUT);
       digitalWrite(device.outputPins[i], LOW);  // HIGH = OFF by default
-      device.outputState[i] = false;
     }
+    device.level = 0;
     // Initialize debouncing variables
     for (size_t i = 0; i < device.inputPins.size(); i++) {
       device.lastDebounceTime[i] = 0;
@@ -0,0 +1,187 @@
+#include <unity.h>
+
+#include "FadeSchedule.h"
+
+static fade_slot_t slot;
+
+void setUp(void)
+{
+    slot = fade_slot_t();
+}
+
+void tearDown(void) {}
+
+// ========= Gamma table =========
+
+void test_gamma_table_endpoints(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(0, fade_level_to_duty(0));
+    TEST_ASSERT_EQUAL_UINT32(FADE_DUTY_MAX, fade_level_to_duty(FADE_LEVEL_MAX));
+}
+
+void test_gamma_table_is_monotonic(void)
+{
+    for (int level = 1; level <= FADE_LEVEL_MAX; level++) {
+        TEST_ASSERT_TRUE(fade_level_to_duty(level) > fade_level_to_duty(level - 1));
+    }
+}
+
+void test_gamma_table_clamps_levels_above_max(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(FADE_DUTY_MAX, fade_level_to_duty(FADE_LEVEL_MAX + 1));
+    TEST_ASSERT_EQUAL_UINT32(FADE_DUTY_MAX, fade_level_to_duty(255));
+}
+
+void test_duty_to_level_round_trip(void)
+{
+    for (int level = 0; level <= FADE_LEVEL_MAX; level++) {
+        TEST_ASSERT_EQUAL_UINT8(level, fade_duty_to_level(fade_level_to_duty(level)));
+    }
+}
+
+// ========= Scheduling =========
+
+void test_request_clamps_level_and_ms(void)
+{
+    fade_step_t step;
+
+    fade_slot_request(&slot, 200, FADE_MAX_MS + 1);
+    TEST_ASSERT_TRUE(fade_slot_next(&slot, 0, 0, &step));
+    TEST_ASSERT_EQUAL_UINT8(FADE_LEVEL_MAX, step.level);
+    TEST_ASSERT_EQUAL_UINT32(FADE_MAX_MS, slot.total_ms);
+}
+
+void test_latest_request_wins(void)
+{
+    fade_step_t step;
+
+    fade_slot_request(&slot, 10, 0);
+    fade_slot_request(&slot, 50, 0);
+    fade_slot_request(&slot, 30, 0);
+
+    TEST_ASSERT_TRUE(fade_slot_next(&slot, 0, 0, &step));
+    TEST_ASSERT_TRUE(step.first);
+    TEST_ASSERT_EQUAL_UINT8(30, step.level);
+    TEST_ASSERT_EQUAL_UINT32(fade_level_to_duty(30), step.duty);
+    fade_slot_started(&slot, true, false);
+
+    TEST_ASSERT_FALSE(fade_slot_next(&slot, step.duty, 0, &step));
+}
+
+void test_immediate_request_clears_busy(void)
+{
+    fade_step_t step;
+
+    fade_slot_request(&slot, 40, 0);
+    TEST_ASSERT_TRUE(fade_slot_next(&slot, 0, 0, &step));
+    TEST_ASSERT_EQUAL_UINT32(0, step.ms);
+    TEST_ASSERT_TRUE(slot.busy);
+
+    fade_slot_started(&slot, true, false);
+    TEST_ASSERT_FALSE(slot.busy);
+    TEST_ASSERT_EQUAL_UINT32(FADE_WAIT_FOREVER, fade_slot_wait_ms(&slot, 0));
+}
+
+void test_request_is_deferred_while_busy(void)
+{
+    fade_step_t step;
+
+    fade_slot_request(&slot, 100, 1000);
+    TEST_ASSERT_TRUE(fade_slot_next(&slot, 0, 0, &step));
+    fade_slot_started(&slot, true, true);
+
+    fade_slot_request(&slot, 0, 0);
+    TEST_ASSERT_FALSE(fade_slot_next(&slot, step.duty / 2, 100, &step));
+    TEST_ASSERT_EQUAL_UINT32(FADE_WAIT_FOREVER, fade_slot_wait_ms(&slot, 100));
+
+    fade_slot_end(&slot);
+    TEST_ASSERT_EQUAL_UINT32(0, fade_slot_wait_ms(&slot, FADE_SEGMENT_MS));
+    TEST_ASSERT_TRUE(fade_slot_next(&slot, 1000, FADE_SEGMENT_MS, &step));
+    TEST_ASSERT_TRUE(step.first);
+    TEST_ASSERT_EQUAL_UINT8(0, step.level);
+    TEST_ASSERT_EQUAL_UINT32(0, step.duty);
+}
+
+// Runs a fade to completion, checking each segment ends on the gamma curve at
+// the level reached after that share of the fade time.
+static void check_fade_follows_curve(uint8_t from, uint8_t to)
+{
+    const int segments = 4;
+    fade_step_t step;
+    uint32_t now = 0;
+    uint32_t duty = fade_level_to_duty(from);
+
+    fade_slot_request(&slot, to, segments * FADE_SEGMENT_MS);
+    for (int i = 0; i < segments; i++) {
+        TEST_ASSERT_TRUE(fade_slot_next(&slot, duty, now, &step));
+        TEST_ASSERT_EQUAL_UINT32(FADE_SEGMENT_MS, step.ms);
+        TEST_ASSERT_EQUAL(i == 0, step.first);
+        TEST_ASSERT_EQUAL_UINT32(fade_level_to_duty(from + (to - from) * (i + 1) / segments), step.duty);
+        fade_slot_started(&slot, true, true);
+
+        // Nothing to do until the hardware reports the end of the segment
+        TEST_ASSERT_FALSE(fade_slot_next(&slot, duty, now + 1, &step));
+        fade_slot_end(&slot);
+        duty = step.duty;
+        now += step.ms;
+    }
+
+    TEST_ASSERT_FALSE(fade_slot_next(&slot, duty, now, &step));
+    TEST_ASSERT_EQUAL_UINT32(FADE_WAIT_FOREVER, fade_slot_wait_ms(&slot, now));
+}
+
+void test_fade_up_follows_gamma_curve(void)
+{
+    check_fade_follows_curve(0, FADE_LEVEL_MAX);
+}
+
+void test_fade_down_follows_gamma_curve(void)
+{
+    check_fade_follows_curve(FADE_LEVEL_MAX, 0);
+}
+
+void test_unchanged_duty_segment_holds_until_its_end(void)
+{
+    fade_step_t step;
+
+    fade_slot_request(&slot, 1, FADE_MAX_MS);
+    TEST_ASSERT_TRUE(fade_slot_next(&slot, 0, 0, &step));
+    TEST_ASSERT_EQUAL_UINT32(0, step.duty);
+    fade_slot_started(&slot, true, false);
+
+    TEST_ASSERT_EQUAL_UINT32(FADE_SEGMENT_MS - 100, fade_slot_wait_ms(&slot, 100));
+    TEST_ASSERT_FALSE(fade_slot_next(&slot, 0, 100, &step));
+    TEST_ASSERT_TRUE(fade_slot_next(&slot, 0, FADE_SEGMENT_MS, &step));
+    TEST_ASSERT_FALSE(step.first);
+}
+
+void test_failed_start_abandons_fade(void)
+{
+    fade_step_t step;
+
+    fade_slot_request(&slot, FADE_LEVEL_MAX, 1000);
+    TEST_ASSERT_TRUE(fade_slot_next(&slot, 0, 0, &step));
+    fade_slot_started(&slot, false, true);
+
+    TEST_ASSERT_FALSE(slot.busy);
+    TEST_ASSERT_FALSE(fade_slot_next(&slot, 0, FADE_SEGMENT_MS, &step));
+    TEST_ASSERT_EQUAL_UINT32(FADE_WAIT_FOREVER, fade_slot_wait_ms(&slot, FADE_SEGMENT_MS));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_gamma_table_endpoints);
+    RUN_TEST(test_gamma_table_is_monotonic);
+    RUN_TEST(test_gamma_table_clamps_levels_above_max);
+    RUN_TEST(test_duty_to_level_round_trip);
+    RUN_TEST(test_request_clamps_level_and_ms);
+    RUN_TEST(test_latest_request_wins);
+    RUN_TEST(test_immediate_request_clears_busy);
+    RUN_TEST(test_request_is_deferred_while_busy);
+    RUN_TEST(test_fade_up_follows_gamma_curve);
+    RUN_TEST(test_fade_down_follows_gamma_curve);
+    RUN_TEST(test_unchanged_duty_segment_holds_until_its_end);
+    RUN_TEST(test_failed_start_abandons_fade);
+    return UNITY_END();
+}